@@ -22,18 +22,51 @@
 #define MSG_SIZE            1024
 #define NICKNAME_SIZE       128
 
+// dimensione massima di un messaggio inoltrato: "<nickname>|<msg>\n"
+#define FRAME_SIZE          (NICKNAME_SIZE + MSG_SIZE + 2)
+
 // struttura dati per i messaggi
 typedef struct msg_s {
     char    nickname[NICKNAME_SIZE];
     char    msg[MSG_SIZE];
+    int     presence;   // 1 se è una notifica di join/leave per gli utenti in #watch
 } msg_t;
 
+// stato del validatore UTF-8 tra un blocco e il successivo (vedi scan.c)
+typedef struct utf8_state_s {
+    unsigned int  need;     // byte di continuazione ancora attesi
+    unsigned char lo, hi;   // intervallo ammesso per il prossimo byte di continuazione
+} utf8_state_t;
+
+// risultato dell'analisi di un messaggio in ingresso (vedi scan.c)
+typedef struct frame_scan_s {
+    size_t  len;            // byte che precedono '\n' (o già esaminati, se complete == 0)
+    int     complete;       // 1 se il messaggio termina con '\n'
+    int     valid_utf8;
+    int     has_control;    // caratteri di controllo ASCII (< 0x20 oppure 0x7F)
+    int     has_delimiter;  // occorrenze di MSG_DELIMITER_CHAR
+    utf8_state_t utf8;      // permette di riprendere l'analisi con scan_frame_resume()
+} frame_scan_t;
+
+// buffer di ricezione associato ad una connessione (vedi recv_msg())
+typedef struct recv_buffer_s {
+    char    data[MSG_SIZE];
+    size_t  start;  // primo byte non ancora consumato
+    size_t  len;    // byte non ancora consumati a partire da start
+    frame_scan_t scan;  // analisi del messaggio corrente, ripresa ad ogni nuovo blocco
+    struct uring_recv_s *uring; // ricezione tramite io_uring, NULL se si usa recv()
+} recv_buffer_t;
+
 // struttura dati per i thread chat_session()
 typedef struct session_thread_args_s {
     int socket;
     struct sockaddr_in* address;
+    recv_buffer_t recv_buf;
 } session_thread_args_t;
 
+// dimensione della voce di un utente nella lista restituita da #list
+#define ROSTER_ENTRY_SIZE   (NICKNAME_SIZE + INET_ADDRSTRLEN + 16)
+
 // struttura dati per gli utenti
 typedef struct user_data_s {
     int     socket;
@@ -42,6 +75,9 @@ typedef struct user_data_s {
     uint16_t    port;
     unsigned int sent_msgs;
     unsigned int rcvd_msgs;
+    char    roster_entry[ROSTER_ENTRY_SIZE]; // voce "nick (ip:porta), " già serializzata
+    size_t  roster_entry_len;
+    int     watch_presence; // 1 se l'utente ha richiesto le notifiche di join/leave
 } user_data_t;
 
 // altri parametri di configurazione del server
@@ -50,10 +86,24 @@ typedef struct user_data_s {
 #define LOG                 1
 #define SERVER_NICKNAME     "chatroom"
 
+// parametri del pool di fan-out (vedi fanout.c)
+#define MAX_FANOUT_WORKERS  64
+#define FANOUT_MIN_USERS    16  // sotto questa soglia il broadcast non usa i worker
+
+// parametri del backend io_uring (vedi uring.c), usato solo se supportato dal kernel
+#define USE_IO_URING        1
+#define URING_RECV_BUFS     8   // buffer forniti al kernel per ogni connessione (potenza di 2)
+#define URING_RECV_BUF_SIZE 512
+
+// parametri della cache per la lista utenti (vedi roster.c)
+#define ROSTER_PAGE_SIZE    (MSG_SIZE - NICKNAME_SIZE)  // spazio per l'intestazione della pagina
+#define ROSTER_MAX_PAGES    MAX_USERS
+
 // codici interni di errore
 #define NICKNAME_NOT_AVAILABLE  -10
 #define TOO_MANY_USERS          -11
 #define USER_NOT_FOUND          -12
+#define NICKNAME_NOT_VALID      -13
 
 // gestione dei messaggi
 #define MSG_DELIMITER_CHAR  '|'
@@ -65,5 +115,10 @@ typedef struct user_data_s {
 #define LIST_COMMAND        "list"
 #define STATS_COMMAND       "stats"
 #define HELP_COMMAND        "help"
+#define WATCH_COMMAND       "watch"
+
+// prefissi delle notifiche inviate agli utenti in #watch
+#define PRESENCE_JOIN_CHAR  '+'
+#define PRESENCE_LEAVE_CHAR '-'
 
 #endif
@@ -0,0 +1,126 @@
+
+// Exercise Implemented by: Bonifacio Marco Francomano (2021)
+//Code: Sapienza, Sistemi di calcolo 2
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "methods.h"
+
+// variabili globali di altri moduli possono essere "richiamate" tramite extern
+extern unsigned int current_users;
+
+/*
+ * Pool di thread che consegnano in parallelo un messaggio ai destinatari.
+ *
+ * Per ogni messaggio l'insieme degli utenti viene diviso in fanout_workers
+ * partizioni contigue: la prima viene servita dal thread di broadcast, le
+ * altre dai worker. broadcast() attende il completamento di tutte le
+ * partizioni prima di passare al messaggio successivo, per cui ogni
+ * utente riceve i messaggi nello stesso ordine in cui sono stati accodati,
+ * e i contatori di ogni utente vengono aggiornati da un solo thread.
+ */
+unsigned int fanout_workers;
+sem_t fanout_start[MAX_FANOUT_WORKERS];
+sem_t fanout_done;
+
+// messaggio in consegna, condiviso in sola lettura con i worker
+msg_t*      fanout_msg;
+const char* fanout_frame;
+size_t      fanout_frame_len;
+unsigned int fanout_chunk; // utenti per partizione
+
+/*
+ * Consegna il messaggio corrente alla partizione index.
+ */
+static void fanout_partition(unsigned int index) {
+    unsigned int from = index * fanout_chunk;
+    unsigned int to = from + fanout_chunk;
+    if (to > current_users) to = current_users;
+    if (from < to) deliver_frame(fanout_msg, fanout_frame, fanout_frame_len, from, to, index);
+}
+
+/*
+ * Metodo eseguito da ogni worker del pool.
+ */
+static void* fanout_routine(void *arg) {
+    unsigned int index = (unsigned int)(uintptr_t)arg;
+    int ret;
+
+    while (1) {
+        ret = sem_wait(&fanout_start[index]);
+        ERROR_HELPER(ret, "Errore nella chiamata sem_wait su fanout_start");
+
+        fanout_partition(index);
+
+        ret = sem_post(&fanout_done);
+        ERROR_HELPER(ret, "Errore nella chiamata sem_post su fanout_done");
+    }
+
+    return NULL;
+}
+
+/*
+ * Avvia num_workers - 1 worker: la prima partizione è sempre servita
+ * dal thread chiamante, quindi con num_workers == 1 non si crea alcun thread.
+ */
+void initialize_fanout(unsigned int num_workers) {
+    int ret;
+    unsigned int i;
+
+    fanout_workers = num_workers;
+
+    ret = sem_init(&fanout_done, 0, 0);
+    ERROR_HELPER(ret, "Errore nell'inizializzazione del semaforo fanout_done");
+
+    for (i = 1; i < fanout_workers; i++) {
+        ret = sem_init(&fanout_start[i], 0, 0);
+        ERROR_HELPER(ret, "Errore nell'inizializzazione del semaforo fanout_start");
+
+        pthread_t thread;
+        ret = pthread_create(&thread, NULL, fanout_routine, (void*)(uintptr_t)i);
+        PTHREAD_ERROR_HELPER(ret, "Errore nella creazione di un worker di fan-out");
+
+        ret = pthread_detach(thread);
+        PTHREAD_ERROR_HELPER(ret, "Errore nel detach di un worker di fan-out");
+    }
+
+    if (LOG) printf("Worker di fan-out: %u\n", fanout_workers);
+}
+
+/*
+ * Consegna frame a tutti gli utenti ripartendoli tra i worker, e ritorna
+ * solo quando tutte le partizioni sono state servite.
+ *
+ * Va invocato tenendo il semaforo user_data_sem.
+ */
+void fanout(msg_t* msg, const char* frame, size_t frame_len) {
+    int ret;
+    unsigned int i, active;
+
+    // con pochi utenti risvegliare i worker costa più della consegna
+    if (fanout_workers <= 1 || current_users < FANOUT_MIN_USERS) {
+        deliver_frame(msg, frame, frame_len, 0, current_users, 0);
+        return;
+    }
+
+    fanout_msg = msg;
+    fanout_frame = frame;
+    fanout_frame_len = frame_len;
+    fanout_chunk = (current_users + fanout_workers - 1) / fanout_workers;
+    active = (current_users + fanout_chunk - 1) / fanout_chunk;
+
+    for (i = 1; i < active; i++) {
+        ret = sem_post(&fanout_start[i]);
+        ERROR_HELPER(ret, "Errore nella chiamata sem_post su fanout_start");
+    }
+
+    fanout_partition(0);
+
+    for (i = 1; i < active; i++) {
+        ret = sem_wait(&fanout_done);
+        ERROR_HELPER(ret, "Errore nella chiamata sem_wait su fanout_done");
+    }
+}
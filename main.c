@@ -41,14 +41,21 @@ void *chat_session(void *arg) {
     char msg[MSG_SIZE];
     char error_msg[MSG_SIZE];
     char nickname[NICKNAME_SIZE];
+    frame_scan_t scan;
 
     int ret;
 
     // lettura del messaggio #join <nick> dal client
-    size_t join_msg_len = recv_msg(args->socket, msg, MSG_SIZE);
+    ssize_t join_msg_len = recv_msg(args->socket, &args->recv_buf, msg, MSG_SIZE, &scan);
     if (join_msg_len < 0) {
         end_chat_session_for_closed_socket(args);
-    } else if (parse_join_msg(msg, join_msg_len, nickname) != 0) { // setta nickname
+    }
+    ret = parse_join_msg(msg, join_msg_len, &scan, nickname); // setta nickname
+    if (ret == NICKNAME_NOT_VALID) {
+        sprintf(error_msg, "Join fallita, il nickname deve essere UTF-8 valido, lungo al massimo %d byte "
+                            "e non può contenere caratteri di controllo o '%c'", NICKNAME_SIZE - 1, MSG_DELIMITER_CHAR);
+        end_chat_session(args, error_msg);
+    } else if (ret != 0) {
         sprintf(error_msg, "Join fallita, messaggio ricevuto: %s", msg);
         end_chat_session(args, error_msg);
     }
@@ -70,14 +77,24 @@ void *chat_session(void *arg) {
     // fase di join completata, inizio sessione di chat
     int quit = 0;
     do {
-        size_t len = recv_msg(args->socket, msg, MSG_SIZE);
+        ssize_t len = recv_msg(args->socket, &args->recv_buf, msg, MSG_SIZE, &scan);
 
-        if (len > 0) {
+        if (len > 0 && !scan.valid_utf8) {
+            // non inoltriamo messaggi che potrebbero corrompere la visualizzazione negli altri client
+            sprintf(error_msg, "Messaggio scartato: il testo non è UTF-8 valido");
+            send_msg_by_server(args->socket, error_msg);
+        } else if (len > 0) {
             // determina se l'input ricevuto è un comando o un messaggio da inoltrare
             if (msg[0] == COMMAND_CHAR) {
                 if (strcmp(msg + 1, LIST_COMMAND) == 0) {
                     printf("Ricevuto comando list dall'utente %s\n", nickname);
-                    send_list(args->socket);
+                    send_list(args->socket, 1);
+                } else if (strncmp(msg + 1, LIST_COMMAND " ", strlen(LIST_COMMAND) + 1) == 0) {
+                    printf("Ricevuto comando list dall'utente %s\n", nickname);
+                    send_list(args->socket, (unsigned int)strtoul(msg + strlen(LIST_COMMAND) + 2, NULL, 10));
+                } else if (strcmp(msg + 1, WATCH_COMMAND) == 0) {
+                    printf("Ricevuto comando watch dall'utente %s\n", nickname);
+                    toggle_watch(args->socket);
                 } else if (strcmp(msg + 1, QUIT_COMMAND) == 0) {
                     printf("Ricevuto comando quit dall'utente %s\n", nickname);
                     quit = 1;
@@ -163,6 +180,10 @@ void listen_on_port(unsigned short port_number_no) {
         session_thread_args_t* args=(session_thread_args_t*)malloc(sizeof(session_thread_args_t));
         args->socket=client_desc;
         args->address=client_addr;
+        args->recv_buf.start=0;
+        args->recv_buf.len=0;
+        scan_frame_begin(&args->recv_buf.scan);
+        args->recv_buf.uring=uring_recv_create(client_desc);
         
         pthread_t thread;
         ret=pthread_create(&thread,NULL,chat_session,args);
@@ -181,8 +202,8 @@ void listen_on_port(unsigned short port_number_no) {
  * Metodo main eseguito per primo nel server.
  */
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Sintassi: %s <port_number>\n", argv[0]);
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Sintassi: %s <port_number> [fanout_workers]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -198,14 +219,38 @@ int main(int argc, char* argv[]) {
     }
     port_number_no = htons((unsigned short)tmp);
 
+    // numero di worker di fan-out: di default uno per ogni core disponibile
+    if (argc == 3) {
+        tmp = strtol(argv[2], NULL, 0);
+        if (tmp < 1 || tmp > MAX_FANOUT_WORKERS) {
+            fprintf(stderr, "Errore: utilizzare un numero di worker compreso tra 1 e %d.\n", MAX_FANOUT_WORKERS);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        tmp = sysconf(_SC_NPROCESSORS_ONLN);
+        if (tmp < 1) tmp = 1;
+        if (tmp > MAX_FANOUT_WORKERS) tmp = MAX_FANOUT_WORKERS;
+    }
+    unsigned int num_fanout_workers = (unsigned int)tmp;
+
     // inizializza strutture dati per gli utenti
     current_users = 0;
     ret = sem_init(&user_data_sem, 0, 1);
     ERROR_HELPER(ret, "Errore nell'inizializzazione del semaforo user_data_sem");
+    initialize_roster();
 
     // inizializza coda per i messaggi
     initialize_queue();
 
+    // seleziona l'implementazione dello scanner per i messaggi in ingresso
+    initialize_scanner();
+
+    // verifica il supporto ad io_uring, con un ring di invio per ogni worker
+    initialize_uring(num_fanout_workers);
+
+    // avvia i worker che consegnano i messaggi in parallelo
+    initialize_fanout(num_fanout_workers);
+
     
 
     pthread_t thread;
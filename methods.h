@@ -1,28 +1,57 @@
 #ifndef __METHODS_H__ // accorgimento per evitare inclusioni multiple di un header
 #define __METHODS_H__
 
+#include <sys/types.h>
 #include <sys/socket.h>
 #include "common.h"
 
 // prototipi dei metodi definiti in msg_queue.c
 void    initialize_queue();
 void    enqueue(const char *nickname, const char *msg);
+void    enqueue_presence(const char *msg);
 msg_t*  dequeue();
 
 // prototipi dei metodi definiti in send_recv.c
 void    send_msg(int socket, const char *msg);
-size_t  recv_msg(int socket, char *buf, size_t buf_len);
+void    send_frame(int socket, const char *frame, size_t frame_len);
+void    send_frame_batch(unsigned int partition, const int *sockets, unsigned int n, const char *frame, size_t frame_len);
+ssize_t recv_msg(int socket, recv_buffer_t *recv_buf, char *buf, size_t buf_len, frame_scan_t *scan);
+
+// prototipi dei metodi definiti in scan.c
+void    initialize_scanner();
+void    scan_frame(const char *buf, size_t len, frame_scan_t *res);
+void    scan_frame_begin(frame_scan_t *res);
+void    scan_frame_resume(const char *buf, size_t len, frame_scan_t *res);
+
+// prototipi dei metodi definiti in roster.c
+void    initialize_roster();
+void    roster_add_user(user_data_t *user);
+void    roster_remove_user(unsigned int index);
+unsigned int roster_get_page(unsigned int page, char *buf);
+
+// prototipi dei metodi definiti in fanout.c
+void    initialize_fanout(unsigned int num_workers);
+void    fanout(msg_t* msg, const char* frame, size_t frame_len);
+
+// prototipi dei metodi definiti in uring.c
+int     initialize_uring(unsigned int num_partitions);
+int     uring_send_batch(unsigned int partition, const int *sockets, unsigned int n, const char *frame, size_t frame_len);
+struct uring_recv_s* uring_recv_create(int socket);
+void    uring_recv_destroy(struct uring_recv_s *ur);
+ssize_t uring_recv(struct uring_recv_s *ur, char *dst, size_t len);
 
 // prototipi dei metodi definiti in util.c
-int     parse_join_msg(char* msg, size_t msg_len, char* nickname);
+int     parse_join_msg(char* msg, size_t msg_len, const frame_scan_t *scan, char* nickname);
 int     user_joining(int socket, const char *nickname, struct sockaddr_in* address);
 int     user_leaving(int socket);
 void    send_msg_by_server(int socket, const char *msg);
 void    broadcast(msg_t* msg);
+void    deliver_frame(msg_t* msg, const char* frame, size_t frame_len, unsigned int from, unsigned int to, unsigned int partition);
 void    end_chat_session_for_closed_socket(session_thread_args_t* args);
 void    end_chat_session(session_thread_args_t* args, const char *msg);
 void    send_help(int socket);
-void    send_list(int socket);
+void    send_list(int socket, unsigned int page);
+void    toggle_watch(int socket);
 void    send_stats(int socket);
 
 #endif
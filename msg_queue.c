@@ -39,21 +39,14 @@ void initialize_queue() {
 }
 
 /*
- * Genera un messaggio a partire dagli argomenti e lo inserisce nella coda.
+ * Inserisce nella coda un messaggio già preparato.
  *
  * Può essere eseguito da più thread contemporaneamente.
  */
-void enqueue(const char *nickname, const char *msg) {
+static void enqueue_msg(msg_t* msg_data) {
 
     int ret;
 
-    // preparo l'elemento msg_t* msg_data da inserire nella coda
-    msg_t* msg_data = (msg_t*)malloc(sizeof(msg_t));
-    sprintf(msg_data->nickname, "%s", nickname);
-    sprintf(msg_data->msg, "%s", msg);
-
-    
-
     ret=sem_wait(&empty);
     if(ret<0) ERROR_HELPER(ret,"errore nella wait");
 
@@ -71,6 +64,34 @@ void enqueue(const char *nickname, const char *msg) {
 
 }
 
+/*
+ * Genera un messaggio a partire dagli argomenti e lo inserisce nella coda.
+ */
+void enqueue(const char *nickname, const char *msg) {
+
+    // preparo l'elemento msg_t* msg_data da inserire nella coda
+    msg_t* msg_data = (msg_t*)malloc(sizeof(msg_t));
+    sprintf(msg_data->nickname, "%s", nickname);
+    sprintf(msg_data->msg, "%s", msg);
+    msg_data->presence = 0;
+
+    enqueue_msg(msg_data);
+}
+
+/*
+ * Inserisce nella coda una notifica di join/leave, che verrà inoltrata
+ * solo agli utenti che l'hanno richiesta con #watch.
+ */
+void enqueue_presence(const char *msg) {
+
+    msg_t* msg_data = (msg_t*)malloc(sizeof(msg_t));
+    sprintf(msg_data->nickname, "%s", SERVER_NICKNAME);
+    sprintf(msg_data->msg, "%s", msg);
+    msg_data->presence = 1;
+
+    enqueue_msg(msg_data);
+}
+
 /*
  * Estrae e restituisce il primo messaggio dalla coda (politica FIFO).
  *
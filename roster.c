@@ -0,0 +1,152 @@
+
+// Exercise Implemented by: Bonifacio Marco Francomano (2021)
+//Code: Sapienza, Sistemi di calcolo 2
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "methods.h"
+
+// variabili globali di altri moduli possono essere "richiamate" tramite extern
+extern user_data_t* users[];
+extern unsigned int current_users;
+
+/*
+ * Cache della lista utenti già serializzata e suddivisa in pagine.
+ *
+ * Ogni pagina contiene solo le voci degli utenti (l'intestazione con il
+ * numero di utenti e di pagina viene aggiunta all'invio), per cui un join
+ * può essere gestito accodando la nuova voce all'ultima pagina. Un leave
+ * rimuove la voce compattando solo la pagina che la contiene, che viene
+ * poi unita alle pagine vicine se il contenuto di entrambe sta in una
+ * pagina sola: due pagine consecutive non possono quindi mai essere unite,
+ * e il numero di pagine resta al più il doppio di quelle strettamente
+ * necessarie anche dopo molti join e leave.
+ *
+ * Le voci compaiono nelle pagine nello stesso ordine di users[]. Le pagine
+ * sono indicizzate tramite roster_page_slot, per cui eliminarne una sposta
+ * solo gli indici delle successive e non il loro contenuto.
+ *
+ * Tutti i metodi vanno invocati tenendo il semaforo user_data_sem.
+ */
+char    roster_bufs[ROSTER_MAX_PAGES][ROSTER_PAGE_SIZE];
+unsigned int roster_page_slot[ROSTER_MAX_PAGES]; // buffer in roster_bufs di ogni pagina
+size_t  roster_page_len[ROSTER_MAX_PAGES];
+unsigned int roster_page_users[ROSTER_MAX_PAGES]; // voci contenute in ogni pagina
+unsigned int roster_num_pages;
+
+#define ROSTER_PAGE(page)   roster_bufs[roster_page_slot[page]]
+
+/*
+ * Inizializza la cache (vuota).
+ */
+void initialize_roster() {
+    unsigned int i;
+    for (i = 0; i < ROSTER_MAX_PAGES; i++) roster_page_slot[i] = i;
+    roster_num_pages = 0;
+}
+
+/*
+ * Elimina la pagina page: il suo buffer torna tra quelli liberi, che
+ * occupano le posizioni di roster_page_slot successive a roster_num_pages.
+ */
+static void roster_drop_page(unsigned int page) {
+    unsigned int slot = roster_page_slot[page];
+    unsigned int next = roster_num_pages - page - 1; // pagine successive da spostare
+
+    memmove(&roster_page_slot[page], &roster_page_slot[page + 1], next * sizeof(unsigned int));
+    memmove(&roster_page_len[page], &roster_page_len[page + 1], next * sizeof(size_t));
+    memmove(&roster_page_users[page], &roster_page_users[page + 1], next * sizeof(unsigned int));
+    roster_num_pages--;
+    roster_page_slot[roster_num_pages] = slot;
+}
+
+/*
+ * Se il contenuto della pagina page e della successiva sta in una pagina
+ * sola, accoda la successiva a page e la elimina.
+ */
+static void roster_merge_next(unsigned int page) {
+    if (page + 1 >= roster_num_pages || roster_page_len[page] + roster_page_len[page + 1] >= ROSTER_PAGE_SIZE) return;
+
+    memcpy(ROSTER_PAGE(page) + roster_page_len[page], ROSTER_PAGE(page + 1), roster_page_len[page + 1] + 1); // copia anche '\0'
+    roster_page_len[page] += roster_page_len[page + 1];
+    roster_page_users[page] += roster_page_users[page + 1];
+    roster_drop_page(page + 1);
+}
+
+/*
+ * Accoda una voce già serializzata all'ultima pagina, aprendone una
+ * nuova se quella corrente non ha spazio sufficiente.
+ */
+static void roster_append_entry(const char *entry, size_t entry_len) {
+    if (roster_num_pages == 0 || roster_page_len[roster_num_pages - 1] + entry_len >= ROSTER_PAGE_SIZE) {
+        roster_page_len[roster_num_pages] = 0;
+        roster_page_users[roster_num_pages] = 0;
+        ROSTER_PAGE(roster_num_pages)[0] = '\0';
+        roster_num_pages++;
+    }
+
+    unsigned int last = roster_num_pages - 1;
+    memcpy(ROSTER_PAGE(last) + roster_page_len[last], entry, entry_len + 1); // copia anche '\0'
+    roster_page_len[last] += entry_len;
+    roster_page_users[last]++;
+}
+
+/*
+ * Prepara la voce del nuovo utente e la aggiunge in coda senza
+ * modificare le pagine precedenti.
+ */
+void roster_add_user(user_data_t *user) {
+    user->roster_entry_len = sprintf(user->roster_entry, "%s (%s:%u), ", user->nickname, user->address, user->port);
+    roster_append_entry(user->roster_entry, user->roster_entry_len);
+}
+
+/*
+ * Rimuove la voce di users[index] dalla pagina che la contiene. Va
+ * invocato prima che l'utente venga rimosso da users[].
+ *
+ * Una pagina rimasta senza voci viene eliminata, altrimenti viene unita
+ * alla successiva e alla precedente quando possibile.
+ */
+void roster_remove_user(unsigned int index) {
+    user_data_t *user = users[index];
+    unsigned int page = 0, first = 0, i;
+
+    // individua la pagina e la posizione della voce al suo interno
+    while (first + roster_page_users[page] <= index)
+        first += roster_page_users[page++];
+
+    size_t offset = 0;
+    for (i = first; i < index; i++) offset += users[i]->roster_entry_len;
+
+    char *entry = ROSTER_PAGE(page) + offset;
+    size_t tail_len = roster_page_len[page] - offset - user->roster_entry_len;
+    memmove(entry, entry + user->roster_entry_len, tail_len + 1); // sposta anche '\0'
+    roster_page_len[page] -= user->roster_entry_len;
+    roster_page_users[page]--;
+
+    if (roster_page_users[page] == 0) {
+        roster_drop_page(page);
+        if (page > 0) roster_merge_next(page - 1); // le pagine ai lati ora sono consecutive
+    } else {
+        roster_merge_next(page);
+        if (page > 0) roster_merge_next(page - 1);
+    }
+}
+
+/*
+ * Scrive in buf (di almeno MSG_SIZE byte) la pagina page della lista
+ * utenti, con la numerazione delle pagine che parte da 1. Restituisce
+ * il numero totale di pagine, o 0 se page non è valida.
+ */
+unsigned int roster_get_page(unsigned int page, char *buf) {
+    unsigned int num_pages = roster_num_pages > 0 ? roster_num_pages : 1; // lista vuota: una pagina vuota
+    if (page < 1 || page > num_pages) return 0;
+
+    int header_len = sprintf(buf, "Lista utenti connessi (%u), pagina %u/%u: ", current_users, page, num_pages);
+    if (roster_num_pages > 0)
+        memcpy(buf + header_len, ROSTER_PAGE(page - 1), roster_page_len[page - 1] + 1);
+
+    return num_pages;
+}
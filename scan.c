@@ -0,0 +1,214 @@
+
+// Exercise Implemented by: Bonifacio Marco Francomano (2021)
+//Code: Sapienza, Sistemi di calcolo 2
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "methods.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+/*
+ * Valida in modo scalare i byte [p, p+len) aggiornando lo stato, che
+ * viene mantenuto tra un blocco e il successivo perché una sequenza
+ * multibyte può essere spezzata a cavallo di due blocchi.
+ * Restituisce 0 se viene trovata una sequenza non valida.
+ */
+static int utf8_step(const unsigned char *p, size_t len, utf8_state_t *st) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        unsigned char c = p[i];
+
+        if (st->need > 0) {
+            if (c < st->lo || c > st->hi) return 0;
+            st->lo = 0x80, st->hi = 0xBF;
+            st->need--;
+            continue;
+        }
+
+        if (c < 0x80) continue;
+        st->lo = 0x80, st->hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            st->need = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            st->need = 2;
+            if (c == 0xE0) st->lo = 0xA0;       // niente codifiche overlong
+            else if (c == 0xED) st->hi = 0x9F;  // niente surrogati
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            st->need = 3;
+            if (c == 0xF0) st->lo = 0x90;       // niente codifiche overlong
+            else if (c == 0xF4) st->hi = 0x8F;  // niente code point oltre U+10FFFF
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Aggiorna il risultato con le maschere calcolate su un blocco di width
+ * byte (un bit per byte). Restituisce 1 se il blocco contiene '\n'.
+ */
+static int scan_block(const unsigned char *p, size_t width, uint32_t nl, uint32_t ctrl,
+                        uint32_t delim, uint32_t high, frame_scan_t *res) {
+    utf8_state_t *st = &res->utf8;
+    int found = 0;
+
+    if (nl) { // consideriamo solo i byte che precedono '\n'
+        width = __builtin_ctz(nl);
+        uint32_t keep = (1u << width) - 1;
+        ctrl &= keep, delim &= keep, high &= keep;
+        found = 1;
+    }
+
+    if (ctrl)  res->has_control = 1;
+    if (delim) res->has_delimiter = 1;
+
+    // percorso veloce: blocco ASCII senza sequenze multibyte in sospeso
+    if ((high || st->need > 0) && res->valid_utf8)
+        res->valid_utf8 = utf8_step(p, width, st);
+
+    res->len += width;
+    if (found) res->complete = 1;
+    return found;
+}
+
+static void scan_frame_scalar(const char *buf, size_t len, frame_scan_t *res, size_t i) {
+    const unsigned char *p = (const unsigned char*)buf;
+    utf8_state_t *st = &res->utf8;
+
+    for (; i < len; i++) {
+        unsigned char c = p[i];
+        if (c == '\n') {
+            res->complete = 1;
+            return;
+        }
+        if (c < 0x20 || c == 0x7F) res->has_control = 1;
+        if (c == MSG_DELIMITER_CHAR) res->has_delimiter = 1;
+        if ((c >= 0x80 || st->need > 0) && res->valid_utf8) res->valid_utf8 = utf8_step(p + i, 1, st);
+        res->len++;
+    }
+}
+
+#ifdef SCAN_X86
+static void scan_frame_sse2(const char *buf, size_t len, frame_scan_t *res) {
+    const __m128i v_nl    = _mm_set1_epi8('\n');
+    const __m128i v_space = _mm_set1_epi8(0x20);
+    const __m128i v_del   = _mm_set1_epi8(0x7F);
+    const __m128i v_delim = _mm_set1_epi8(MSG_DELIMITER_CHAR);
+    size_t i = res->len; // si riprende dal primo byte non ancora esaminato
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(buf + i));
+        uint32_t high  = _mm_movemask_epi8(v);
+        uint32_t nl    = _mm_movemask_epi8(_mm_cmpeq_epi8(v, v_nl));
+        // il confronto è con segno: i byte >= 0x80 risultano negativi e vanno esclusi
+        uint32_t ctrl  = (_mm_movemask_epi8(_mm_cmplt_epi8(v, v_space)) & ~high)
+                        | _mm_movemask_epi8(_mm_cmpeq_epi8(v, v_del));
+        uint32_t delim = _mm_movemask_epi8(_mm_cmpeq_epi8(v, v_delim));
+
+        if (scan_block((const unsigned char*)buf + i, 16, nl, ctrl, delim, high, res)) return;
+    }
+
+    scan_frame_scalar(buf, len, res, i);
+}
+
+__attribute__((target("avx2")))
+static void scan_frame_avx2(const char *buf, size_t len, frame_scan_t *res) {
+    const __m256i v_nl    = _mm256_set1_epi8('\n');
+    const __m256i v_ctrl  = _mm256_set1_epi8(0x1F);
+    const __m256i v_del   = _mm256_set1_epi8(0x7F);
+    const __m256i v_delim = _mm256_set1_epi8(MSG_DELIMITER_CHAR);
+    size_t i = res->len;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(buf + i));
+        uint32_t high  = _mm256_movemask_epi8(v);
+        uint32_t nl    = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_nl));
+        // AVX2 ha solo cmpgt: c < 0x20 equivale a !(c > 0x1F), con segno come sopra
+        uint32_t ctrl  = (~_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, v_ctrl)) & ~high)
+                        | _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_del));
+        uint32_t delim = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_delim));
+
+        if (scan_block((const unsigned char*)buf + i, 32, nl, ctrl, delim, high, res)) return;
+    }
+
+    scan_frame_scalar(buf, len, res, i);
+}
+#endif
+
+// implementazione scelta da initialize_scanner() in base alla CPU
+static void (*scan_impl)(const char *buf, size_t len, frame_scan_t *res) = NULL;
+
+static void scan_frame_generic(const char *buf, size_t len, frame_scan_t *res) {
+    scan_frame_scalar(buf, len, res, res->len);
+}
+
+/*
+ * Seleziona l'implementazione vettoriale migliore supportata dalla CPU.
+ */
+void initialize_scanner() {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_impl = scan_frame_avx2;
+        if (LOG) printf("Scanner dei messaggi: AVX2\n");
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_impl = scan_frame_sse2;
+        if (LOG) printf("Scanner dei messaggi: SSE2\n");
+    } else
+#endif
+    {
+        scan_impl = scan_frame_generic;
+        if (LOG) printf("Scanner dei messaggi: scalare\n");
+    }
+}
+
+/*
+ * Prepara res per l'analisi di un nuovo messaggio.
+ */
+void scan_frame_begin(frame_scan_t *res) {
+    res->len = 0;
+    res->complete = 0;
+    res->valid_utf8 = 1;
+    res->has_control = 0;
+    res->has_delimiter = 0;
+    res->utf8.need = 0;
+}
+
+/*
+ * Prosegue l'analisi di buf, i cui primi res->len byte sono già stati
+ * esaminati da una chiamata precedente: usato quando il messaggio arriva
+ * in più blocchi, per non esaminare di nuovo i byte già visti.
+ *
+ * Se '\n' non viene ancora trovato, res->complete vale 0, res->len == len
+ * e valid_utf8 indica solo che finora non sono stati trovati errori.
+ */
+void scan_frame_resume(const char *buf, size_t len, frame_scan_t *res) {
+    if (res->complete || res->len >= len) return;
+
+    if (scan_impl == NULL) initialize_scanner();
+    scan_impl(buf, len, res);
+
+    if (res->complete && res->utf8.need > 0) res->valid_utf8 = 0;
+}
+
+/*
+ * Esamina in una sola passata i len byte di buf: cerca il primo '\n' e,
+ * per i byte che lo precedono, verifica la validità UTF-8 e la presenza
+ * di caratteri di controllo o di MSG_DELIMITER_CHAR.
+ *
+ * Se '\n' non viene trovato, res->complete vale 0 e res->len == len; una
+ * sequenza multibyte troncata alla fine del buffer rende valid_utf8 nullo.
+ */
+void scan_frame(const char *buf, size_t len, frame_scan_t *res) {
+    scan_frame_begin(res);
+    scan_frame_resume(buf, len, res);
+
+    if (res->utf8.need > 0) res->valid_utf8 = 0;
+}
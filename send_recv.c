@@ -12,16 +12,24 @@
  * Invia il messaggio contenuto nel buffer sulla socket desiderata.
  */
 void send_msg(int socket, const char *msg) {
-    int ret;
-
     // preparo msg_to_send copiando la stringa msg e aggiungendo '\n'
-    char msg_to_send[MSG_SIZE];
-    sprintf(msg_to_send, "%s\n", msg);
+    char msg_to_send[FRAME_SIZE];
+    int msg_len = sprintf(msg_to_send, "%s\n", msg);
+
+    send_frame(socket, msg_to_send, msg_len);
+}
 
-   int written_bytes=0;
-   int msg_len=strlen(msg_to_send);
-   while(written_bytes<msg_len){
-    ret=send(socket,msg_to_send+written_bytes,msg_len-written_bytes,0);
+/*
+ * Invia sulla socket desiderata un messaggio già terminato da '\n'.
+ *
+ * Usato dal broadcast per inviare lo stesso buffer a tutti i destinatari
+ * senza doverlo ricopiare per ognuno di essi.
+ */
+void send_frame(int socket, const char *frame, size_t frame_len) {
+   int ret;
+   size_t written_bytes=0;
+   while(written_bytes<frame_len){
+    ret=send(socket,frame+written_bytes,frame_len-written_bytes,0);
     if(ret==-1 && errno==EINTR) continue;
     if(ret==-1) ERROR_HELPER(ret,"errore scrittura socket");
     written_bytes+=ret;
@@ -29,6 +37,20 @@ void send_msg(int socket, const char *msg) {
    }
 }
 
+/*
+ * Invia lo stesso messaggio già terminato da '\n' a più socket.
+ *
+ * Con io_uring tutti gli invii partono con una sola syscall, sul ring
+ * riservato alla partizione del fan-out che esegue il metodo.
+ */
+void send_frame_batch(unsigned int partition, const int *sockets, unsigned int n, const char *frame, size_t frame_len) {
+    if (n == 0 || uring_send_batch(partition, sockets, n, frame, frame_len) == 0) return;
+
+    unsigned int i;
+    for (i = 0; i < n; i++)
+        send_frame(sockets[i], frame, frame_len);
+}
+
 /*
  * Riceve un messaggio dalla socket desiderata e lo memorizza nel
  * buffer buf di dimensione massima buf_len bytes.
@@ -37,28 +59,70 @@ void send_msg(int socket, const char *msg) {
  * speciale '\n'. Il valore restituito dal metodo è il numero di byte
  * letti ('\n' escluso), o -1 nel caso in cui il client ha chiuso la
  * connessione in modo inaspettato.
+ *
+ * I dati vengono letti a blocchi in recv_buf, che conserva gli eventuali
+ * byte dei messaggi successivi tra una chiamata e l'altra. Ogni blocco
+ * viene esaminato da scan_frame_resume(), che individua la fine del
+ * messaggio e ne verifica il contenuto riprendendo dal punto in cui si
+ * era fermata, per cui ogni byte viene esaminato una volta sola anche se
+ * il messaggio arriva a pezzi: l'esito è riportato in scan.
+ *
+ * Se per la connessione è attivo io_uring, i blocchi arrivano dalla recv
+ * multishot gestita in uring.c anziché da una chiamata a recv().
  */
-
-size_t recv_msg(int socket, char *buf, size_t buf_len) {
+ssize_t recv_msg(int socket, recv_buffer_t *recv_buf, char *buf, size_t buf_len, frame_scan_t *scan) {
     int ret;
-    int bytes_read = 0;
+    size_t capacity = sizeof(recv_buf->data);
+
+    while (1) {
+        char *data = recv_buf->data + recv_buf->start;
+
+        scan_frame_resume(data, recv_buf->len, &recv_buf->scan);
 
-    // messaggi più lunghi di buf_len bytes vengono troncati
-    while (bytes_read <= buf_len) {
-       
-       
-        ret = recv(socket, buf + bytes_read, 1, 0);
+        if (recv_buf->len > 0 && (recv_buf->scan.complete || recv_buf->len == capacity)) {
+            *scan = recv_buf->scan;
+            size_t msg_len = scan->len, consumed = scan->len + 1; // '\n' viene scartato
+
+            if (!scan->complete) {
+                /* Messaggio più lungo del buffer: viene troncato senza
+                 * spezzare una sequenza UTF-8, il resto diventa il
+                 * messaggio successivo. Solo in questo caso la parte
+                 * conservata viene esaminata di nuovo, per escludere
+                 * dall'esito i byte scartati. */
+                msg_len = capacity - 1;
+                while (msg_len > 0 && ((unsigned char)data[msg_len] & 0xC0) == 0x80) msg_len--;
+                if (msg_len == 0) msg_len = capacity - 1;
+                scan_frame(data, msg_len, scan);
+                consumed = msg_len;
+            }
+
+            // messaggi più lunghi di buf_len bytes vengono troncati
+            if (msg_len > buf_len - 1) msg_len = buf_len - 1;
+            memcpy(buf, data, msg_len);
+            buf[msg_len] = '\0';
+
+            recv_buf->start += consumed;
+            recv_buf->len -= consumed;
+            if (recv_buf->len == 0) recv_buf->start = 0;
+            scan_frame_begin(&recv_buf->scan); // il prossimo messaggio parte da recv_buf->start
+            return msg_len;
+        }
+
+        // sposta i byte non consumati all'inizio del buffer per fare spazio
+        if (recv_buf->start > 0) {
+            memmove(recv_buf->data, data, recv_buf->len);
+            recv_buf->start = 0;
+        }
+
+        if (recv_buf->uring != NULL)
+            ret = uring_recv(recv_buf->uring, recv_buf->data + recv_buf->len, capacity - recv_buf->len);
+        else
+            ret = recv(socket, recv_buf->data + recv_buf->len, capacity - recv_buf->len, 0);
 
         if (ret == 0) return -1; // il client ha chiuso la socket
         if (ret == -1 && errno == EINTR) continue;
-        if(ret==-1) ERROR_HELPER(ret, "Errore nella lettura da socket");
+        if (ret == -1) ERROR_HELPER(ret, "Errore nella lettura da socket");
 
-        // controllo ultimo byte letto
-        if (buf[bytes_read++] == '\n') break; // fine del messaggio: non incrementare bytes_read
+        recv_buf->len += ret;
     }
-
-    /* Quando un messaggio viene ricevuto correttamente, il carattere
-     * finale '\n' viene sostituito con un terminatore di stringa. */
-    buf[bytes_read] = '\0';
-    return bytes_read; // si noti che ora bytes_read == strlen(buf)
 }
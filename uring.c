@@ -0,0 +1,465 @@
+
+// Exercise Implemented by: Bonifacio Marco Francomano (2021)
+//Code: Sapienza, Sistemi di calcolo 2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "common.h"
+#include "methods.h"
+
+/*
+ * Backend io_uring per le operazioni su socket, senza dipendere da liburing.
+ *
+ * - Invio: ogni partizione del fan-out (vedi fanout.c) ha un proprio ring,
+ *   su cui vengono accodate le send per tutti i destinatari e poi inviate
+ *   al kernel con una sola io_uring_enter(), che attende anche i completamenti.
+ * - Ricezione: ogni connessione ha un piccolo ring con una recv multishot
+ *   che il kernel completa più volte, scrivendo in buffer forniti in anticipo
+ *   tramite un buffer ring registrato; non serve una syscall per riarmarla.
+ *
+ * Il supporto viene verificato a runtime da initialize_uring(): se il kernel
+ * (o la configurazione) non lo permette, si usano recv() e send().
+ *
+ * In compilazione non basta che <linux/io_uring.h> esista: header più
+ * vecchi del kernel usato a runtime possono non definire tutto ciò che
+ * serve, per cui ogni parte viene compilata solo se le sue definizioni
+ * sono presenti (altrimenti si usano le versioni vuote in fondo al file).
+ */
+
+#if USE_IO_URING && defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+
+// IORING_OP_SEND e IORING_REGISTER_PROBE sono enum: si verifica la macro introdotta insieme (5.6)
+#ifdef IO_URING_OP_SUPPORTED
+#define URING_AVAILABLE 1
+#endif
+
+// la recv multishot (6.0) è successiva ai buffer ring registrati (5.19)
+#if defined(URING_AVAILABLE) && defined(IORING_RECV_MULTISHOT)
+#define URING_RECV_AVAILABLE 1
+#endif
+#endif
+
+#ifdef URING_AVAILABLE
+
+// puntatori alle strutture condivise con il kernel tramite mmap()
+typedef struct uring_s {
+    int         fd;
+    unsigned    *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned    *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void        *sq_ptr, *cq_ptr;
+    size_t      sq_size, cq_size, sqes_size;
+} uring_t;
+
+#ifdef URING_RECV_AVAILABLE
+// valori di user_data per distinguere i completamenti sul ring di ricezione
+#define URING_RECV_TAG      1
+#define URING_CANCEL_TAG    2
+
+// stato della ricezione tramite io_uring per una connessione
+struct uring_recv_s {
+    uring_t     ring;
+    int         socket;
+    struct io_uring_buf_ring *buf_ring;
+    size_t      buf_ring_size;
+    char        *bufs;          // URING_RECV_BUFS buffer da URING_RECV_BUF_SIZE byte
+    int         armed;          // 1 se la recv multishot è ancora attiva
+    int         fallback;       // 1 se il kernel non supporta la recv multishot
+    int         pending_bid;    // buffer con dati non ancora consegnati, o -1
+    size_t      pending_off, pending_len;
+};
+#endif
+
+int uring_enabled = 0;
+uring_t send_rings[MAX_FANOUT_WORKERS];
+
+static int uring_setup(uring_t *ring, unsigned int entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0) return -1;
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            munmap(ring->sq_ptr, ring->sq_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+        munmap(ring->sq_ptr, ring->sq_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr, *cq = ring->cq_ptr;
+    ring->sq_head  = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->cq_head  = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+static void uring_teardown(uring_t *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+}
+
+/*
+ * Restituisce una SQE azzerata in coda al ring; il chiamante non deve
+ * accodarne più di quante ne sono state richieste a uring_setup().
+ */
+static struct io_uring_sqe* uring_get_sqe(uring_t *ring) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    return sqe;
+}
+
+/*
+ * Sottomette le SQE accodate e non ancora lette dal kernel, attendendo
+ * almeno wait_nr completamenti.
+ */
+static int uring_enter(uring_t *ring, unsigned int wait_nr) {
+    unsigned to_submit = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static struct io_uring_cqe* uring_peek_cqe(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+static void uring_cqe_seen(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Verifica che il kernel supporti le operazioni usate e prepara un ring
+ * di invio per ognuna delle num_partitions partizioni del fan-out.
+ */
+int initialize_uring(unsigned int num_partitions) {
+    uring_t probe_ring;
+    unsigned int i;
+
+    if (uring_setup(&probe_ring, 4) < 0) {
+        if (LOG) printf("Backend I/O: recv/send (io_uring non disponibile: %s)\n", strerror(errno));
+        return 0;
+    }
+
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    int ret = syscall(__NR_io_uring_register, probe_ring.fd, IORING_REGISTER_PROBE, probe, 256);
+    int supported = ret >= 0
+        && probe->last_op >= IORING_OP_SEND && (probe->ops[IORING_OP_SEND].flags & IO_URING_OP_SUPPORTED)
+        && probe->last_op >= IORING_OP_RECV && (probe->ops[IORING_OP_RECV].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    uring_teardown(&probe_ring);
+
+    if (!supported) {
+        if (LOG) printf("Backend I/O: recv/send (send/recv non supportate da io_uring)\n");
+        return 0;
+    }
+
+    for (i = 0; i < num_partitions; i++)
+        if (uring_setup(&send_rings[i], MAX_USERS) < 0) {
+            while (i-- > 0) uring_teardown(&send_rings[i]);
+            if (LOG) printf("Backend I/O: recv/send (io_uring_setup fallita: %s)\n", strerror(errno));
+            return 0;
+        }
+
+    uring_enabled = 1;
+#ifdef URING_RECV_AVAILABLE
+    if (LOG) printf("Backend I/O: io_uring\n");
+#else
+    if (LOG) printf("Backend I/O: io_uring per l'invio, recv() per la ricezione\n");
+#endif
+    return 1;
+}
+
+/*
+ * Invia frame a tutti i socket indicati con una sola io_uring_enter().
+ * Eventuali invii parziali vengono completati con send_frame().
+ *
+ * Restituisce -1 se io_uring non è disponibile: il chiamante deve allora
+ * procedere con send_frame() per ogni socket.
+ */
+int uring_send_batch(unsigned int partition, const int *sockets, unsigned int n, const char *frame, size_t frame_len) {
+    if (!uring_enabled) return -1;
+
+    uring_t *ring = &send_rings[partition];
+    unsigned int i, done = 0;
+    int ret;
+
+    for (i = 0; i < n; i++) {
+        struct io_uring_sqe *sqe = uring_get_sqe(ring);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = sockets[i];
+        sqe->addr = (unsigned long)frame;
+        sqe->len = frame_len;
+        sqe->user_data = i;
+    }
+
+    while (done < n) {
+        ret = uring_enter(ring, n - done);
+        if (ret == -1 && errno == EINTR) continue;
+        ERROR_HELPER(ret, "Errore nella chiamata io_uring_enter");
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(ring)) != NULL) {
+            int socket = sockets[cqe->user_data];
+            int res = cqe->res;
+            uring_cqe_seen(ring);
+            done++;
+
+            if (res == -EINTR || res == -EAGAIN) res = 0; // si riprova in modo sincrono
+            if (res < 0) {
+                errno = -res;
+                ERROR_HELPER(res, "errore scrittura socket");
+            }
+            if (res < frame_len) send_frame(socket, frame + res, frame_len - res);
+        }
+    }
+
+    return 0;
+}
+
+#ifdef URING_RECV_AVAILABLE
+
+/*
+ * Restituisce al kernel il buffer bid perché possa essere riutilizzato.
+ */
+static void uring_recycle_buf(struct uring_recv_s *ur, int bid) {
+    struct io_uring_buf_ring *br = ur->buf_ring;
+    unsigned short tail = br->tail;
+
+    struct io_uring_buf *buf = &br->bufs[tail & (URING_RECV_BUFS - 1)];
+    buf->addr = (unsigned long)(ur->bufs + (size_t)bid * URING_RECV_BUF_SIZE);
+    buf->len = URING_RECV_BUF_SIZE;
+    buf->bid = bid;
+    __atomic_store_n(&br->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Prepara la ricezione tramite io_uring per una nuova connessione.
+ * Restituisce NULL se io_uring non è disponibile.
+ */
+struct uring_recv_s* uring_recv_create(int socket) {
+    if (!uring_enabled) return NULL;
+
+    struct uring_recv_s *ur = calloc(1, sizeof(struct uring_recv_s));
+    if (uring_setup(&ur->ring, 4) < 0) {
+        free(ur);
+        return NULL;
+    }
+
+    ur->socket = socket;
+    ur->pending_bid = -1;
+    ur->buf_ring_size = URING_RECV_BUFS * sizeof(struct io_uring_buf);
+    ur->buf_ring = mmap(NULL, ur->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ur->bufs = malloc((size_t)URING_RECV_BUFS * URING_RECV_BUF_SIZE);
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)ur->buf_ring;
+    reg.ring_entries = URING_RECV_BUFS;
+    reg.bgid = 0;
+
+    if (ur->buf_ring == MAP_FAILED
+            || syscall(__NR_io_uring_register, ur->ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        // kernel precedente al 5.19: niente buffer ring, si usa recv()
+        if (ur->buf_ring != MAP_FAILED) munmap(ur->buf_ring, ur->buf_ring_size);
+        free(ur->bufs);
+        uring_teardown(&ur->ring);
+        free(ur);
+        return NULL;
+    }
+
+    int i;
+    ur->buf_ring->tail = 0;
+    for (i = 0; i < URING_RECV_BUFS; i++) uring_recycle_buf(ur, i);
+
+    return ur;
+}
+
+/*
+ * Libera le risorse associate alla connessione.
+ *
+ * La chiusura del ring non annulla subito la recv multishot, che potrebbe
+ * ancora scrivere in ur->bufs: prima di liberare i buffer la recv viene
+ * annullata esplicitamente, attendendo il suo ultimo completamento (senza
+ * IORING_CQE_F_MORE), e il buffer ring viene rimosso dal kernel.
+ */
+void uring_recv_destroy(struct uring_recv_s *ur) {
+    int cancel_pending = 0;
+
+    if (ur->armed) {
+        struct io_uring_sqe *sqe = uring_get_sqe(&ur->ring);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = URING_RECV_TAG;
+        sqe->user_data = URING_CANCEL_TAG;
+        cancel_pending = 1;
+    }
+
+    while (ur->armed || cancel_pending) {
+        struct io_uring_cqe *cqe = uring_peek_cqe(&ur->ring);
+
+        if (cqe == NULL) {
+            if (uring_enter(&ur->ring, 1) < 0 && errno != EINTR) break; // il buffer ring viene comunque rimosso
+            continue;
+        }
+
+        if (cqe->user_data == URING_RECV_TAG && !(cqe->flags & IORING_CQE_F_MORE)) ur->armed = 0;
+        if (cqe->user_data == URING_CANCEL_TAG) cancel_pending = 0;
+        uring_cqe_seen(&ur->ring);
+    }
+
+    // da qui in poi il kernel non può più selezionare alcun buffer
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = 0;
+    syscall(__NR_io_uring_register, ur->ring.fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+    uring_teardown(&ur->ring);
+    munmap(ur->buf_ring, ur->buf_ring_size);
+    free(ur->bufs);
+    free(ur);
+}
+
+/*
+ * Equivalente di recv(ur->socket, dst, len, 0): copia in dst i dati del
+ * prossimo buffer completato dalla recv multishot, riarmandola se il
+ * kernel l'ha terminata.
+ */
+ssize_t uring_recv(struct uring_recv_s *ur, char *dst, size_t len) {
+    if (ur->fallback) return recv(ur->socket, dst, len, 0);
+
+    while (ur->pending_bid < 0) {
+        struct io_uring_cqe *cqe = uring_peek_cqe(&ur->ring);
+
+        if (cqe == NULL) {
+            if (!ur->armed) {
+                struct io_uring_sqe *sqe = uring_get_sqe(&ur->ring);
+                sqe->opcode = IORING_OP_RECV;
+                sqe->fd = ur->socket;
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = 0;
+                sqe->user_data = URING_RECV_TAG;
+                ur->armed = 1;
+            }
+            if (uring_enter(&ur->ring, 1) < 0) return -1; // errno già impostato (es. EINTR)
+            continue;
+        }
+
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        uring_cqe_seen(&ur->ring);
+
+        if (!(flags & IORING_CQE_F_MORE)) ur->armed = 0;
+
+        if (res == -ENOBUFS) continue; // buffer esauriti: la recv viene riarmata
+        if (res == -EINVAL) {
+            // kernel precedente al 6.0: recv multishot non supportata
+            ur->fallback = 1;
+            return recv(ur->socket, dst, len, 0);
+        }
+        if (res < 0) {
+            errno = -res;
+            return -1;
+        }
+        if (res == 0) return 0; // il client ha chiuso la socket
+
+        ur->pending_bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        ur->pending_off = 0;
+        ur->pending_len = res;
+    }
+
+    size_t n = ur->pending_len - ur->pending_off;
+    if (n > len) n = len;
+    memcpy(dst, ur->bufs + (size_t)ur->pending_bid * URING_RECV_BUF_SIZE + ur->pending_off, n);
+    ur->pending_off += n;
+
+    if (ur->pending_off == ur->pending_len) {
+        uring_recycle_buf(ur, ur->pending_bid);
+        ur->pending_bid = -1;
+    }
+
+    return n;
+}
+
+#endif // URING_RECV_AVAILABLE
+
+#else
+
+// io_uring non disponibile in compilazione: si usano sempre recv() e send()
+
+int initialize_uring(unsigned int num_partitions) {
+    if (LOG) printf("Backend I/O: recv/send\n");
+    return 0;
+}
+
+int uring_send_batch(unsigned int partition, const int *sockets, unsigned int n, const char *frame, size_t frame_len) {
+    return -1;
+}
+
+#endif
+
+#ifndef URING_RECV_AVAILABLE
+
+// ricezione tramite io_uring non disponibile in compilazione: si usa sempre recv()
+
+struct uring_recv_s* uring_recv_create(int socket) {
+    return NULL;
+}
+
+void uring_recv_destroy(struct uring_recv_s *ur) {
+}
+
+ssize_t uring_recv(struct uring_recv_s *ur, char *dst, size_t len) {
+    return -1;
+}
+
+#endif
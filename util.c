@@ -16,19 +16,27 @@ extern unsigned int current_users;
 
 /*
  * Processa un messaggio #join ed estrae il nickname in esso specificato
- * scrivendolo nel buffer passato come terzo argomento.
+ * scrivendolo nel buffer passato come ultimo argomento.
+ *
+ * L'esito di scan_frame() sul messaggio permette di rifiutare nickname
+ * che romperebbero il parsing dei client (MSG_DELIMITER_CHAR, caratteri
+ * di controllo, UTF-8 non valido) senza esaminarli di nuovo.
  */
 char join_msg_prefix[MSG_SIZE];
 size_t join_msg_prefix_len = 0;
 
-int parse_join_msg(char* msg, size_t msg_len, char* nickname) {
+int parse_join_msg(char* msg, size_t msg_len, const frame_scan_t *scan, char* nickname) {
     // vogliamo eseguire le operazioni nel blocco una volta sola per efficienza
     if (join_msg_prefix_len == 0) {
         sprintf(join_msg_prefix, "%c%s ", COMMAND_CHAR, JOIN_COMMAND);
         join_msg_prefix_len = strlen(join_msg_prefix);
     }
 
-    if (msg_len > join_msg_prefix_len && !strncmp(msg, join_msg_prefix, join_msg_prefix_len)) {
+    if (msg_len > join_msg_prefix_len && !memcmp(msg, join_msg_prefix, join_msg_prefix_len)) {
+        // il prefisso non contiene caratteri proibiti, quindi le informazioni di scan valgono per il nickname
+        if (!scan->valid_utf8 || scan->has_control || scan->has_delimiter
+                || msg_len - join_msg_prefix_len >= NICKNAME_SIZE)
+            return NICKNAME_NOT_VALID;
         sprintf(nickname, "%s", msg + join_msg_prefix_len);
         return 0;
     } else {
@@ -71,7 +79,9 @@ int user_joining(int socket, const char *nickname, struct sockaddr_in* address)
     new_user->port = ntohs(address->sin_port);
     new_user->sent_msgs = 0,
     new_user->rcvd_msgs = 0;
+    new_user->watch_presence = 0;
     users[current_users++] = new_user;
+    roster_add_user(new_user);
 
     // notifica la presenza a tutti gli utenti
     char msg[MSG_SIZE];
@@ -79,6 +89,10 @@ int user_joining(int socket, const char *nickname, struct sockaddr_in* address)
     if (LOG) printf("%s\n", msg);
     enqueue(SERVER_NICKNAME, msg); // anche il nuovo utente lo riceverà
 
+    // notifica compatta per gli utenti in #watch
+    sprintf(msg, "%c%s (%s:%u)", PRESENCE_JOIN_CHAR, new_user->nickname, new_user->address, new_user->port);
+    enqueue_presence(msg);
+
     ret = sem_post(&user_data_sem);
     ERROR_HELPER(ret, "Errore nella chiamata sem_post su user_data_sem");
 
@@ -105,6 +119,10 @@ int user_leaving(int socket) {
 
             enqueue(SERVER_NICKNAME, msg);
 
+            sprintf(msg, "%c%s", PRESENCE_LEAVE_CHAR, users[i]->nickname);
+            enqueue_presence(msg);
+
+            roster_remove_user(i);
             free(users[i]);
             for (; i < current_users - 1; i++)
                 users[i] = users[i+1]; // shift di 1 per tutti gli elementi successivi
@@ -137,7 +155,11 @@ void send_msg_by_server(int socket, const char *msg) {
  * Inoltra un messaggio di un utente a tutti gli altri nella chatroom.
  *
  * Nel caso in cui il messaggio sia originato da SERVER_NICKNAME, esso
- * viene inviato a tutti gli utenti connessi.
+ * viene inviato a tutti gli utenti connessi. Le notifiche di join/leave
+ * vengono invece inviate solo agli utenti in #watch.
+ *
+ * Il messaggio viene formattato una sola volta e la consegna viene
+ * ripartita tra i worker di fan-out (vedi fanout.c).
  */
 void broadcast(msg_t* msg) {
 
@@ -145,21 +167,38 @@ void broadcast(msg_t* msg) {
     ret = sem_wait(&user_data_sem);
     ERROR_HELPER(ret, "Errore nella chiamata sem_wait su user_data_sem");
 
-    int i;
-    char msg_to_send[MSG_SIZE];
-    sprintf(msg_to_send, "%s%c%s", msg->nickname, MSG_DELIMITER_CHAR, msg->msg);
+    char msg_to_send[FRAME_SIZE];
+    int msg_len = sprintf(msg_to_send, "%s%c%s\n", msg->nickname, MSG_DELIMITER_CHAR, msg->msg);
 
-    for (i = 0; i < current_users; i++) {
-        if (strcmp(msg->nickname, users[i]->nickname) != 0) {
-            send_msg(users[i]->socket, msg_to_send);
+    fanout(msg, msg_to_send, msg_len);
+
+    ret = sem_post(&user_data_sem);
+    ERROR_HELPER(ret, "Errore nella chiamata sem_post su user_data_sem");
+}
+
+/*
+ * Invia frame agli utenti users[from..to-1] aggiornandone i contatori.
+ *
+ * Può essere eseguito da più worker contemporaneamente su intervalli
+ * disgiunti, mentre il thread di broadcast tiene user_data_sem. Gli
+ * invii vengono raccolti e passati insieme a send_frame_batch().
+ */
+void deliver_frame(msg_t* msg, const char* frame, size_t frame_len, unsigned int from, unsigned int to, unsigned int partition) {
+    int sockets[MAX_USERS];
+    unsigned int i, n = 0;
+
+    for (i = from; i < to; i++) {
+        if (msg->presence) {
+            if (users[i]->watch_presence) sockets[n++] = users[i]->socket;
+        } else if (strcmp(msg->nickname, users[i]->nickname) != 0) {
+            sockets[n++] = users[i]->socket;
             users[i]->rcvd_msgs++;
         } else {
             users[i]->sent_msgs++;
         }
     }
 
-    ret = sem_post(&user_data_sem);
-    ERROR_HELPER(ret, "Errore nella chiamata sem_post su user_data_sem");
+    send_frame_batch(partition, sockets, n, frame, frame_len);
 }
 
 /*
@@ -169,6 +208,7 @@ void broadcast(msg_t* msg) {
  * sua connessione in modo inatteso per il server.
  */
 void end_chat_session_for_closed_socket(session_thread_args_t* args) {
+    if (args->recv_buf.uring != NULL) uring_recv_destroy(args->recv_buf.uring);
     int ret = close(args->socket);
     ERROR_HELPER(ret, "Errore nella chiusura di una socket");
     free(args->address);
@@ -198,7 +238,11 @@ void send_help(int socket) {
     sprintf(msg, "La lista dei comandi disponibili è la seguente:");
     send_msg_by_server(socket, msg);
 
-    sprintf(msg, "\t%c%s: stampa la lista degli utenti correntemente connessi", COMMAND_CHAR, LIST_COMMAND);
+    sprintf(msg, "\t%c%s [pagina]: stampa la lista degli utenti correntemente connessi", COMMAND_CHAR, LIST_COMMAND);
+    send_msg_by_server(socket, msg);
+
+    sprintf(msg, "\t%c%s: attiva/disattiva le notifiche di ingresso (%c) e uscita (%c) degli utenti",
+                    COMMAND_CHAR, WATCH_COMMAND, PRESENCE_JOIN_CHAR, PRESENCE_LEAVE_CHAR);
     send_msg_by_server(socket, msg);
 
     sprintf(msg, "\t%c%s: termina la sessione", COMMAND_CHAR, QUIT_COMMAND);
@@ -215,22 +259,44 @@ void send_help(int socket) {
 }
 
 /*
- * Eseguito in risposta ad un comando #list.
+ * Eseguito in risposta ad un comando #list [pagina].
+ *
+ * La lista viene letta dalla cache mantenuta in roster.c, per cui in
+ * assenza di join/leave il costo è quello di una copia di MSG_SIZE byte.
+ */
+void send_list(int socket, unsigned int page) {
+    char msg[MSG_SIZE];
+    int ret;
+
+    ret = sem_wait(&user_data_sem);
+    ERROR_HELPER(ret, "Errore nella chiamata sem_wait su user_data_sem");
+
+    unsigned int num_pages = roster_get_page(page, msg);
+
+    ret = sem_post(&user_data_sem);
+    ERROR_HELPER(ret, "Errore nella chiamata sem_post su user_data_sem");
+
+    if (num_pages == 0) sprintf(msg, "Pagina %u inesistente", page);
+    send_msg_by_server(socket, msg);
+}
+
+/*
+ * Eseguito in risposta ad un comando #watch.
  */
-void send_list(int socket) {
+void toggle_watch(int socket) {
     char msg[MSG_SIZE];
     int ret;
 
     ret = sem_wait(&user_data_sem);
     ERROR_HELPER(ret, "Errore nella chiamata sem_wait su user_data_sem");
 
-    sprintf(msg, "Lista utenti connessi (%d): ", current_users);
     int i;
-    for (i = 0; i < current_users; i++) {
-        char tmp[MSG_SIZE];
-        sprintf(tmp, "%s (%s:%u), ", users[i]->nickname, users[i]->address, users[i]->port);
-        strcat(msg, tmp);
-    }
+    for (i = 0; i < current_users; i++)
+        if (users[i]->socket == socket) {
+            users[i]->watch_presence = !users[i]->watch_presence;
+            sprintf(msg, "Notifiche di ingresso/uscita %s", users[i]->watch_presence ? "attivate" : "disattivate");
+            break;
+        }
 
     ret = sem_post(&user_data_sem);
     ERROR_HELPER(ret, "Errore nella chiamata sem_post su user_data_sem");